@@ -6,13 +6,16 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "rhs2116.h"
+#ifndef RHS2116_HOST
 #include "spidrv.h"
+#endif
 
 static Rhs2116_Context_t rhs2116_context;
 uint32_t tx_buffer;
 uint32_t rx_buffer;
 uint16_t testVal = 0;
 
+#ifndef RHS2116_HOST
 // Flag to signal that transfer is complete
 static volatile bool transfer_complete = false;
 
@@ -29,9 +32,73 @@ void transfer_callback(SPIDRV_HandleData_t *handle, Ecode_t transfer_status,
 	}
 }
 
+static uint32_t spidrv_tx;
+static uint32_t spidrv_rx;
+
+static void spidrv_frame(void) {
+	Ecode_t ecode;
+	transfer_complete = false;
+	ecode = SPIDRV_MTransfer(rhs2116_context.spiHandle, &spidrv_tx, &spidrv_rx,
+			sizeof(spidrv_tx), transfer_callback);
+	EFM_ASSERT(ecode == ECODE_EMDRV_SPIDRV_OK);
+
+	// Wait for the transfer to complete
+	while (!transfer_complete)
+		;
+}
+
+// SPIDRV transport: the command, then two dummy cycles to clock out its result
+static uint32_t spidrv_command(void *ctx, uint32_t txWord) {
+	(void) ctx;
+
+	spidrv_tx = txWord;
+	spidrv_frame();
+
+	// dummy cycles
+	spidrv_tx = 0;
+	spidrv_frame();
+	spidrv_frame();
+
+	return spidrv_rx;
+}
+
+// SPIDRV transport, pipelined: each result arrives RHS_PIPELINE_DEPTH frames after its command
+static void spidrv_batch(void *ctx, const uint32_t *txWords, uint32_t *rxWords,
+		size_t count) {
+	const uint32_t flushWord = rhs2116_flushCommand();
+	size_t i;
+	(void) ctx;
+
+	for (i = 0; i < count + RHS_PIPELINE_DEPTH; i++) {
+		spidrv_tx = (i < count) ? txWords[i] : flushWord;
+		spidrv_frame();
+		if (i >= RHS_PIPELINE_DEPTH) {
+			rxWords[i - RHS_PIPELINE_DEPTH] = spidrv_rx;
+		}
+	}
+}
+
 void rhs2116_init(SPIDRV_Handle_t spiHandle) {
-	int i;
+	Rhs2116_Transport_t transport = { spidrv_command, spidrv_batch, NULL };
 	rhs2116_context.spiHandle = spiHandle;
+	rhs2116_initTransport(&transport);
+}
+#endif
+
+/*
+ * Selects the transport without touching the chip (e.g. to attach a replay
+ * session to an already configured driver).
+ */
+void rhs2116_setTransport(const Rhs2116_Transport_t *transport) {
+	rhs2116_context.transport = *transport;
+}
+
+/*
+ * Runs the full configuration sequence over the given transport.
+ */
+void rhs2116_initTransport(const Rhs2116_Transport_t *transport) {
+	int i;
+	rhs2116_setTransport(transport);
 	rhs2116_checkId();			// make sure the chip is online
 	rhs2116_STIM_EN_A(0x0000);// Ensure that stimulation is disabled until we configure all others
 	rhs2116_STIM_EN_B(0x0000);	// ^
@@ -76,49 +143,34 @@ void rhs2116_init(SPIDRV_Handle_t spiHandle) {
 }
 
 uint16_t do_transfer(void) {
-	Ecode_t ecode;
-	transfer_complete = false;
-	ecode = SPIDRV_MTransfer(rhs2116_context.spiHandle, &tx_buffer, &rx_buffer,
-			sizeof(tx_buffer), transfer_callback);
-	EFM_ASSERT(ecode == ECODE_EMDRV_SPIDRV_OK);
-
-	// Wait for the transfer to complete
-	while (!transfer_complete)
-		;
-
-	// dummy cycles
+	rx_buffer = rhs2116_context.transport.command(rhs2116_context.transport.ctx,
+			tx_buffer);
 	tx_buffer = 0;
-	rx_buffer = 0;
-	transfer_complete = false;
-	ecode = SPIDRV_MTransfer(rhs2116_context.spiHandle, &tx_buffer, &rx_buffer,
-			sizeof(tx_buffer), transfer_callback);
-	EFM_ASSERT(ecode == ECODE_EMDRV_SPIDRV_OK);
-
-	// Wait for the transfer to complete
-	while (!transfer_complete)
-		;
-
-	rx_buffer = 0; // tx is still clear
-	transfer_complete = false;
-	ecode = SPIDRV_MTransfer(rhs2116_context.spiHandle, &tx_buffer, &rx_buffer,
-			sizeof(tx_buffer), transfer_callback);
-	EFM_ASSERT(ecode == ECODE_EMDRV_SPIDRV_OK);
 
-	// Wait for the transfer to complete
-	while (!transfer_complete)
-		;
+	return rhs2116_registerResult(rx_buffer);
+}
 
-	// get bytes back in order
-	uint16_t receivedData = ((rx_buffer >> 8) & 0xFF00) // Extracts the second byte and places it in the high byte
-	| ((rx_buffer >> 24) & 0x00FF); // Extracts the high-order byte and places it in the low byte
+/*
+ * Sends count commands back to back and stores the MISO word answering each one
+ * in rxWords. Uses the transport's pipelined batch when it has one (one frame
+ * per command plus RHS_PIPELINE_DEPTH to flush), otherwise one command() round trip each.
+ */
+void rhs2116_commandBatch(const uint32_t *txWords, uint32_t *rxWords, size_t count) {
+	size_t i;
 
-	return receivedData;
+	if (rhs2116_context.transport.batch != NULL) {
+		rhs2116_context.transport.batch(rhs2116_context.transport.ctx, txWords,
+				rxWords, count);
+		return;
+	}
+	for (i = 0; i < count; i++) {
+		rxWords[i] = rhs2116_context.transport.command(
+				rhs2116_context.transport.ctx, txWords[i]);
+	}
 }
 
-bool rhs2116_writeRegister(uint8_t regAddress, uint16_t regValue, bool uFlag,
+uint32_t rhs2116_writeCommand(uint8_t regAddress, uint16_t regValue, bool uFlag,
 bool mFlag) {
-	tx_buffer = 0;
-
 	// Split regValue into MSB and LSB
 	uint8_t dataMSB = (regValue >> 8) & 0xFF; // Extract MSB of the data
 	uint8_t dataLSB = regValue & 0xFF;		  // Extract LSB of the data
@@ -133,30 +185,82 @@ bool mFlag) {
 	}
 
 	// Assemble the command with dataLSB in the most significant position
-	tx_buffer = ((uint32_t) dataLSB << 24) | ((uint32_t) dataMSB << 16)
+	return ((uint32_t) dataLSB << 24) | ((uint32_t) dataMSB << 16)
 			| ((uint32_t) regAddress << 8) | lsbCommand;
+}
 
-	uint16_t receivedData = do_transfer();
-
-	// Check if the received value matches the sent value
-	if (receivedData == regValue) {
-		return true; // Data integrity check passed
+uint32_t rhs2116_readCommand(uint8_t regAddress, bool uFlag, bool mFlag) {
+	uint8_t lsbCommand = 0xC0; // Bits 7 and 6 set to 1, bits 5-0 set to 0 as base
+	if (uFlag) {
+		lsbCommand |= 0x20; // Set U flag (bit 5)
 	}
-	return false; // Data integrity check failed
+	if (mFlag) {
+		lsbCommand |= 0x10; // Set M flag (bit 4)
+	}
+
+	return ((uint32_t) regAddress << 8) | (uint32_t) lsbCommand;
 }
 
-uint16_t rhs2116_readRegister(uint8_t regAddress, bool uFlag, bool mFlag) {
-	tx_buffer = 0;
+/*
+ * Word clocked out after the last command of a batch to flush the pipeline. It
+ * reads the chip ID rather than sending all zeros, which would be a CONVERT of
+ * channel 0.
+ */
+uint32_t rhs2116_flushCommand(void) {
+	return rhs2116_readCommand(RHS_CHIP_ID, false, false);
+}
 
-	uint8_t lsbCommand = 0xC0; // Bits 7 and 6 set to 1, bits 5-0 set to 0 as base
+uint32_t rhs2116_convertCommand(uint8_t channel, bool uFlag, bool mFlag,
+bool dFlag, bool hFlag) {
+	uint8_t lsbCommand = 0x00; // Bits 7 and 6 set to 0, bits 5-0 set to 0 as base
 	if (uFlag) {
 		lsbCommand |= 0x20; // Set U flag (bit 5)
 	}
 	if (mFlag) {
 		lsbCommand |= 0x10; // Set M flag (bit 4)
 	}
+	if (dFlag) {
+		lsbCommand |= 0x08;
+	}
+	if (hFlag) {
+		lsbCommand |= 0x04;
+	}
+
+	return ((uint32_t) channel << 8) | (uint32_t) lsbCommand;
+}
+
+// Register data (READ/WRITE) is in the last two bytes on the wire
+uint16_t rhs2116_registerResult(uint32_t rxWord) {
+	// get bytes back in order
+	uint16_t receivedData = ((rxWord >> 8) & 0xFF00) // Extracts the second byte and places it in the high byte
+	| ((rxWord >> 24) & 0x00FF); // Extracts the high-order byte and places it in the low byte
+
+	return receivedData;
+}
+
+// The AC result is the first two bytes on the wire, the 10-bit DC result the last two
+uint16_t rhs2116_convertResult(uint32_t rxWord, bool dFlag) {
+	if (dFlag) {
+		return rhs2116_registerResult(rxWord);
+	}
+	return ((rxWord << 8) & 0xFF00) | ((rxWord >> 8) & 0xFF);
+}
+
+bool rhs2116_writeRegister(uint8_t regAddress, uint16_t regValue, bool uFlag,
+bool mFlag) {
+	tx_buffer = rhs2116_writeCommand(regAddress, regValue, uFlag, mFlag);
 
-	tx_buffer = ((uint32_t) regAddress << 8) | (uint32_t) lsbCommand;
+	uint16_t receivedData = do_transfer();
+
+	// Check if the received value matches the sent value
+	if (receivedData == regValue) {
+		return true; // Data integrity check passed
+	}
+	return false; // Data integrity check failed
+}
+
+uint16_t rhs2116_readRegister(uint8_t regAddress, bool uFlag, bool mFlag) {
+	tx_buffer = rhs2116_readCommand(regAddress, uFlag, mFlag);
 	uint16_t receivedData = do_transfer();
 	return receivedData;
 }
@@ -184,32 +288,21 @@ bool rhs2116_checkId(void) {
 
 uint16_t rhs2116_convert(uint8_t channel, bool uFlag, bool mFlag, bool dFlag,
 bool hFlag) {
-	tx_buffer = 0;
-
-	uint8_t lsbCommand = 0x00; // Bits 7 and 6 set to 1, bits 5-0 set to 0 as base
-	if (uFlag) {
-		lsbCommand |= 0x20; // Set U flag (bit 5)
-	}
-	if (mFlag) {
-		lsbCommand |= 0x10; // Set M flag (bit 4)
-	}
-	if (dFlag) {
-		lsbCommand |= 0x08;
-	}
-	if (hFlag) {
-		lsbCommand |= 0x04;
-	}
-
-	tx_buffer = ((uint32_t) channel << 16) | (uint32_t) lsbCommand;
-	uint16_t receivedData = do_transfer();
+	tx_buffer = rhs2116_convertCommand(channel, uFlag, mFlag, dFlag, hFlag);
+	do_transfer();
 
 	// receivedData would be the 10-bit version if (dFlag), otherwise return 16-bit
 	// rx_buffer is still full from do_transfer()
-	if (!dFlag) {
-		receivedData = (rx_buffer & 0xFF00) | ((rx_buffer >> 8) & 0xFF);
-	}
+	return rhs2116_convertResult(rx_buffer, dFlag);
+}
 
-	return receivedData;
+/*
+ * Runs one sample period of a schedule (see rhs2116_plan.h) as a single batch.
+ * results receives schedule->count raw MISO words; decode conversions with
+ * rhs2116_convertResult().
+ */
+void rhs2116_runSchedule(const Rhs2116_Schedule_t *schedule, uint32_t *results) {
+	rhs2116_commandBatch(schedule->commands, results, schedule->count);
 }
 
 /*
@@ -6,7 +6,12 @@
 #ifndef RHS2116_H
 #define RHS2116_H
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#ifndef RHS2116_HOST // host builds (replay, tools) have no Silicon Labs SPIDRV
 #include "spidrv.h"
+#endif
 
 #define CHIP_ID 0x20
 #define RHS_CLEAR 0x6A
@@ -73,21 +78,70 @@
 #define RHS_NCH 254
 #define RHS_CHIP_ID 255 // RHS2116 = 32 (0x20)
 
+#define RHS_SCHEDULE_MAX 32 // commands per sample period
+#define RHS_PIPELINE_DEPTH 2 // frames between a command and the MISO word answering it
+
+/*
+ * Bus transport used by the driver. command() shifts one 32-bit command out on
+ * MOSI and returns the MISO word that answers it, i.e. the word clocked in
+ * RHS_PIPELINE_DEPTH frames later once the chip's pipeline has been flushed.
+ * batch() (optional) does the same for count commands sent back to back,
+ * followed by RHS_PIPELINE_DEPTH flush frames; rxWords[i] answers txWords[i].
+ */
+typedef struct
+{
+	uint32_t (*command)(void *ctx, uint32_t txWord);
+	void (*batch)(void *ctx, const uint32_t *txWords, uint32_t *rxWords, size_t count);
+	void *ctx;
+} Rhs2116_Transport_t;
+
+/*
+ * Commands issued every sample period, in order (built by rhs2116_plan()).
+ * Stim and monitor slots hold placeholder reads that the application may
+ * overwrite with its own commands before running the period.
+ */
+typedef struct
+{
+	uint32_t commands[RHS_SCHEDULE_MAX];
+	uint8_t count;
+	uint8_t channelCount;	  // conversions come first, in channel order
+	uint8_t channels[16];	  // chip channel converted by commands[i]
+	uint8_t firstStimSlot;
+	uint8_t stimSlots;
+	uint8_t firstMonitorSlot;
+	uint8_t monitorSlots;
+} Rhs2116_Schedule_t;
+
 typedef struct
 {
+#ifndef RHS2116_HOST
 	SPIDRV_Handle_t spiHandle;
+#endif
+	Rhs2116_Transport_t transport;
 } Rhs2116_Context_t;
 
+#ifndef RHS2116_HOST
 void rhs2116_init(SPIDRV_Handle_t spiHandle);
 void transfer_callback(SPIDRV_HandleData_t *handle, Ecode_t transfer_status,
 					   int items_transferred);
+#endif
+void rhs2116_initTransport(const Rhs2116_Transport_t *transport);
+void rhs2116_setTransport(const Rhs2116_Transport_t *transport);
 uint16_t do_transer(void);
+void rhs2116_commandBatch(const uint32_t *txWords, uint32_t *rxWords, size_t count);
+uint32_t rhs2116_writeCommand(uint8_t regAddress, uint16_t regValue, bool uFlag, bool mFlag);
+uint32_t rhs2116_readCommand(uint8_t regAddress, bool uFlag, bool mFlag);
+uint32_t rhs2116_flushCommand(void);
+uint32_t rhs2116_convertCommand(uint8_t channel, bool uFlag, bool mFlag, bool dFlag, bool hFlag);
+uint16_t rhs2116_registerResult(uint32_t rxWord);
+uint16_t rhs2116_convertResult(uint32_t rxWord, bool dFlag);
 bool rhs2116_writeRegister(uint8_t regAddress, uint16_t regValue, bool uFlag, bool mFlag);
 uint16_t rhs2116_readRegister(uint8_t regAddress, bool uFlag, bool mFlag);
 void rhs2116_clear(void);
 bool rhs2116_clearComplianceMonitor(void);
 bool rhs2116_checkId(void);
 uint16_t rhs2116_convert(uint8_t channel, bool uFlag, bool mFlag, bool dFlag, bool hFlag);
+void rhs2116_runSchedule(const Rhs2116_Schedule_t *schedule, uint32_t *results);
 bool rhs2116_SUPPS_BIASCURR(uint8_t adcBufferBias, uint8_t muxBias);
 bool rhs2116_OUTFMT_DSP_AUXDIO(uint8_t dspCutoffFreq, bool dspEn, bool absMode, bool twosComp, bool weakMiso, bool digout1HiZ, bool digout1, bool digout2HiZ, bool digout2, bool digoutOD);
 bool rhs2116_IMPCHK_CTRL(bool zcheckEn, uint8_t zcheckScale,
@@ -0,0 +1,118 @@
+/***************************************************************************//**
+ * @file rhs2116_plan.c
+ * @brief Sample-rate and bus-timing planner for the RHS2116
+ ******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "rhs2116_plan.h"
+
+/*
+ * Register 0 bias settings versus total ADC sampling rate (datasheet table).
+ * The last row applies to every rate above the previous one.
+ */
+static const struct
+{
+	uint32_t maxRate;
+	uint8_t adcBufferBias;
+	uint8_t muxBias;
+} biasTable[] = {
+	{ 120000, 32, 40 },
+	{ 140000, 16, 40 },
+	{ 175000, 8, 40 },
+	{ 220000, 8, 32 },
+	{ 280000, 8, 26 },
+	{ 350000, 4, 18 },
+	{ 440000, 3, 16 },
+	{ 525000, 3, 7 },
+	{ UINT32_MAX, 2, 4 },
+};
+
+void rhs2116_planBias(uint32_t totalRate, uint8_t *adcBufferBias, uint8_t *muxBias) {
+	size_t i = 0;
+
+	while (totalRate > biasTable[i].maxRate) {
+		i++;
+	}
+	*adcBufferBias = biasTable[i].adcBufferBias;
+	*muxBias = biasTable[i].muxBias;
+}
+
+/*
+ * Computes the fastest per-channel rate the bus sustains and the matching
+ * schedule. One period is every enabled channel's CONVERT, then the stim
+ * slots, then the monitor slots. Without a pipelined transport each command
+ * costs 1 + RHS_PIPELINE_DEPTH frames (do_transfer()); with one, a period costs
+ * one frame per command plus RHS_PIPELINE_DEPTH flush frames. The ADC/MUX biases are chosen for the
+ * resulting frame rate, dummy and flush frames included, since every frame
+ * clocks the MUX.
+ */
+bool rhs2116_plan(const Rhs2116_PlanRequest_t *request, Rhs2116_Plan_t *plan) {
+	Rhs2116_Schedule_t *schedule = &plan->schedule;
+	uint64_t frameNs;
+	uint64_t periodNs;
+	uint32_t gapNs;
+	uint8_t channel;
+	uint8_t i;
+
+	memset(plan, 0, sizeof(*plan));
+	if (request->spiClockHz < RHS_SPI_MIN_HZ || request->spiClockHz > RHS_SPI_MAX_HZ
+			|| request->channelMask == 0) {
+		return false;
+	}
+
+	for (channel = 0; channel < 16; channel++) {
+		if (request->channelMask & (1u << channel)) {
+			schedule->channels[schedule->channelCount] = channel;
+			schedule->commands[schedule->count++] = rhs2116_convertCommand(channel,
+					request->uFlag, request->mFlag, request->dFlag, request->hFlag);
+			schedule->channelCount++;
+		}
+	}
+	if (schedule->count + request->stimSlots + request->monitorSlots > RHS_SCHEDULE_MAX) {
+		return false;
+	}
+
+	schedule->firstStimSlot = schedule->count;
+	schedule->stimSlots = request->stimSlots;
+	for (i = 0; i < request->stimSlots; i++) {
+		schedule->commands[schedule->count++] = rhs2116_readCommand(RHS_CHIP_ID, false,
+				false);
+	}
+	schedule->firstMonitorSlot = schedule->count;
+	schedule->monitorSlots = request->monitorSlots;
+	for (i = 0; i < request->monitorSlots; i++) {
+		schedule->commands[schedule->count++] = rhs2116_readCommand(
+				(i & 1) ? RHS_FAULT_CUR_DET : RHS_COMPL_MON, false, false);
+	}
+
+	gapNs = (request->frameGapNs > RHS_T_CSOFF_NS) ? request->frameGapNs : RHS_T_CSOFF_NS;
+	frameNs = ((uint64_t) RHS_FRAME_BITS * 1000000000u + request->spiClockHz - 1)
+			/ request->spiClockHz + gapNs;
+
+	plan->framesPerPeriod = request->pipelined ? schedule->count + (uint32_t) RHS_PIPELINE_DEPTH
+			: schedule->count * (1u + RHS_PIPELINE_DEPTH);
+	periodNs = plan->framesPerPeriod * frameNs;
+	if (periodNs >= 1000000000u) { // slower than 1 Hz per channel
+		return false;
+	}
+	plan->periodNs = (uint32_t) periodNs;
+	plan->sampleRateHz = 1000000000u / plan->periodNs;
+	plan->totalRate = plan->sampleRateHz * plan->framesPerPeriod;
+	rhs2116_planBias(plan->totalRate, &plan->adcBufferBias, &plan->muxBias);
+	return true;
+}
+
+/*
+ * Writes the plan's bias settings and powers exactly the planned AC amplifiers.
+ */
+bool rhs2116_applyPlan(const Rhs2116_Plan_t *plan) {
+	uint16_t acAmpPower = 0;
+	uint8_t i;
+
+	for (i = 0; i < plan->schedule.channelCount; i++) {
+		acAmpPower |= (uint16_t) (1u << plan->schedule.channels[i]);
+	}
+	return rhs2116_SUPPS_BIASCURR(plan->adcBufferBias, plan->muxBias)
+			&& rhs2116_ACAMP_PWR(acAmpPower);
+}
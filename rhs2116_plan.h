@@ -0,0 +1,47 @@
+/***************************************************************************//**
+ * @file rhs2116_plan.h
+ * @brief Sample-rate and bus-timing planner for the RHS2116
+ ******************************************************************************/
+
+#ifndef RHS2116_PLAN_H
+#define RHS2116_PLAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rhs2116.h"
+
+#define RHS_SPI_MAX_HZ 24000000 // maximum SCLK frequency
+#define RHS_SPI_MIN_HZ 1000		// slower clocks cannot sustain even 1 Hz with a full schedule
+#define RHS_T_CSOFF_NS 154		// minimum CS high time between frames
+#define RHS_FRAME_BITS 32
+
+typedef struct
+{
+	uint32_t spiClockHz;
+	uint16_t channelMask; // channels converted every period (RHS_ACAMP_PWR layout)
+	bool uFlag;			  // flags set on every CONVERT
+	bool mFlag;
+	bool dFlag;
+	bool hFlag;
+	uint8_t stimSlots;	  // commands reserved per period for stimulation updates
+	uint8_t monitorSlots; // commands reserved per period for compliance/fault reads
+	uint32_t frameGapNs;  // CS high plus host turnaround per frame, at least RHS_T_CSOFF_NS
+	bool pipelined;		  // transport implements batch(): one frame per command
+} Rhs2116_PlanRequest_t;
+
+typedef struct
+{
+	uint32_t sampleRateHz;	  // maximum per-channel sample rate
+	uint32_t periodNs;		  // bus time of one sample period
+	uint32_t framesPerPeriod; // SPI frames per period, flush/dummy frames included
+	uint32_t totalRate;		  // frames per second seen by the ADC/MUX
+	uint8_t adcBufferBias;	  // register 0 settings for totalRate
+	uint8_t muxBias;
+	Rhs2116_Schedule_t schedule;
+} Rhs2116_Plan_t;
+
+bool rhs2116_plan(const Rhs2116_PlanRequest_t *request, Rhs2116_Plan_t *plan);
+void rhs2116_planBias(uint32_t totalRate, uint8_t *adcBufferBias, uint8_t *muxBias);
+bool rhs2116_applyPlan(const Rhs2116_Plan_t *plan);
+
+#endif // RHS2116_PLAN_H
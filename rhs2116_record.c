@@ -0,0 +1,301 @@
+/***************************************************************************//**
+ * @file rhs2116_record.c
+ * @brief Chunked, indexed recording container: streaming writer and codec
+ ******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "rhs2116_record.h"
+
+#define REC_STAGE_BYTES 64
+
+static uint16_t popcount16(uint16_t value) {
+	uint16_t count = 0;
+	while (value) {
+		value &= value - 1;
+		count++;
+	}
+	return count;
+}
+
+static bool rec_emit(Rhs2116_RecWriter_t *writer, const void *data, size_t len) {
+	if (!writer->ok) {
+		return false;
+	}
+	if (len > 0 && !writer->cfg.sink(writer->cfg.sinkCtx, data, len)) {
+		writer->ok = false;
+		return false;
+	}
+	writer->offset += len;
+	return true;
+}
+
+static bool rec_pad(Rhs2116_RecWriter_t *writer) {
+	static const uint8_t zeros[8] = { 0 };
+	return rec_emit(writer, zeros, (8 - (writer->offset & 7)) & 7);
+}
+
+static uint16_t zigzag(uint16_t current, uint16_t previous) {
+	uint16_t delta = (uint16_t) (current - previous);
+	return (uint16_t) ((delta << 1) ^ (0u - (delta >> 15)));
+}
+
+static size_t put_varint(uint16_t value, uint8_t *out) {
+	size_t len = 0;
+	while (value >= 0x80) {
+		if (out) {
+			out[len] = (uint8_t) (value | 0x80);
+		}
+		len++;
+		value >>= 7;
+	}
+	if (out) {
+		out[len] = (uint8_t) value;
+	}
+	return len + 1;
+}
+
+/*
+ * Encodes a channel column as zigzag LEB128 deltas (1-3 bytes per sample).
+ * With out == NULL only the encoded size is computed.
+ */
+size_t rhs2116_recEncodeDelta(const uint16_t *column, uint32_t count, uint8_t *out) {
+	size_t len = 0;
+	uint16_t previous = 0;
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		len += put_varint(zigzag(column[i], previous), out ? &out[len] : NULL);
+		previous = column[i];
+	}
+	return len;
+}
+
+/*
+ * Decodes the next count samples of a delta-coded column, resuming at byte *pos
+ * after sample value *previous (both 0 at the start of a column), and writes
+ * every stride-th element of out (out may be NULL to skip samples). Returns
+ * false if the column is truncated.
+ */
+bool rhs2116_recDecodeDeltaNext(const uint8_t *in, size_t len, size_t *pos,
+		uint16_t *previous, uint32_t count, uint16_t *out, size_t stride) {
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		uint16_t value = 0;
+		uint8_t shift = 0;
+		uint8_t byte;
+		do {
+			if (*pos >= len || shift > 14) {
+				return false;
+			}
+			byte = in[(*pos)++];
+			value |= (uint16_t) ((byte & 0x7F) << shift);
+			shift += 7;
+		} while (byte & 0x80);
+
+		*previous = (uint16_t) (*previous + (int16_t) ((value >> 1) ^ -(value & 1)));
+		if (out) {
+			out[(size_t) i * stride] = *previous;
+		}
+	}
+	return true;
+}
+
+/*
+ * Decodes samples [skip, skip + count) of a delta-coded column into out, writing
+ * every stride-th element. Returns false if the column is truncated.
+ */
+bool rhs2116_recDecodeDelta(const uint8_t *in, size_t len, uint32_t skip, uint32_t count,
+		uint16_t *out, size_t stride) {
+	size_t pos = 0;
+	uint16_t previous = 0;
+
+	return rhs2116_recDecodeDeltaNext(in, len, &pos, &previous, skip, NULL, 0)
+			&& rhs2116_recDecodeDeltaNext(in, len, &pos, &previous, count, out, stride);
+}
+
+/*
+ * Streams a delta-coded column to the sink through a small staging buffer so no
+ * chunk-sized scratch memory is needed.
+ */
+static bool rec_emitDeltaColumn(Rhs2116_RecWriter_t *writer, const uint16_t *column,
+		uint32_t count) {
+	uint8_t stage[REC_STAGE_BYTES];
+	size_t fill = 0;
+	uint16_t previous = 0;
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		if (fill > REC_STAGE_BYTES - 3) {
+			if (!rec_emit(writer, stage, fill)) {
+				return false;
+			}
+			fill = 0;
+		}
+		fill += put_varint(zigzag(column[i], previous), &stage[fill]);
+		previous = column[i];
+	}
+	return rec_emit(writer, stage, fill);
+}
+
+bool rhs2116_recWriterBegin(Rhs2116_RecWriter_t *writer, const Rhs2116_RecConfig_t *cfg) {
+	Rhs2116_RecHeader_t header;
+
+	memset(writer, 0, sizeof(*writer));
+	writer->cfg = *cfg;
+	writer->channelCount = popcount16(cfg->channelMask);
+	writer->ok = true;
+
+	if (cfg->sink == NULL || cfg->chunkBuffer == NULL || cfg->chunkFrames == 0
+			|| writer->channelCount == 0 || cfg->codec > RHS_REC_CODEC_DELTA) {
+		writer->ok = false;
+		return false;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, RHS_REC_MAGIC, sizeof(RHS_REC_MAGIC));
+	header.version = RHS_REC_VERSION;
+	header.channelCount = writer->channelCount;
+	header.chunkFrames = cfg->chunkFrames;
+	header.sampleRateHz = cfg->sampleRateHz;
+	header.channelMask = cfg->channelMask;
+	header.codec = cfg->codec;
+
+	return rec_emit(writer, &header, sizeof(header));
+}
+
+/*
+ * Appends frameCount frames of channelCount interleaved samples. Samples are
+ * copied once, into their column of the chunk buffer; a full chunk is handed to
+ * the sink directly from that buffer. A gap in frameCounter starts a new chunk.
+ */
+bool rhs2116_recWriterAppend(Rhs2116_RecWriter_t *writer, uint64_t frameCounter,
+		uint64_t timestampUs, const uint16_t *samples, uint32_t frameCount) {
+	const uint32_t chunkFrames = writer->cfg.chunkFrames;
+	const uint16_t channels = writer->channelCount;
+	uint32_t i;
+	uint16_t c;
+
+	if (!writer->ok) {
+		return false;
+	}
+
+	for (i = 0; i < frameCount; i++) {
+		if (writer->chunkFill > 0
+				&& frameCounter + i != writer->chunkFrameCounter + writer->chunkFill) {
+			if (!rhs2116_recWriterFlush(writer)) {
+				return false;
+			}
+		}
+		if (writer->chunkFill == 0) {
+			writer->chunkFrameCounter = frameCounter + i;
+			writer->chunkTimestampUs = timestampUs;
+			if (writer->cfg.sampleRateHz) {
+				writer->chunkTimestampUs += (uint64_t) i * 1000000 / writer->cfg.sampleRateHz;
+			}
+		}
+
+		for (c = 0; c < channels; c++) {
+			writer->cfg.chunkBuffer[(size_t) c * chunkFrames + writer->chunkFill] =
+					samples[(size_t) i * channels + c];
+		}
+		writer->chunkFill++;
+		writer->frameCount++;
+
+		if (writer->chunkFill == chunkFrames && !rhs2116_recWriterFlush(writer)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Writes the buffered (possibly partial) chunk and records it in the index.
+ */
+bool rhs2116_recWriterFlush(Rhs2116_RecWriter_t *writer) {
+	const uint32_t chunkFrames = writer->cfg.chunkFrames;
+	const uint32_t fill = writer->chunkFill;
+	Rhs2116_RecChunkHeader_t chunk;
+	uint32_t offset = 0;
+	uint16_t c;
+
+	if (!writer->ok) {
+		return false;
+	}
+	if (fill == 0) {
+		return true;
+	}
+
+	memset(&chunk, 0, sizeof(chunk));
+	chunk.magic = RHS_REC_CHUNK_MAGIC;
+	chunk.frameCount = fill;
+	chunk.frameCounter = writer->chunkFrameCounter;
+	chunk.timestampUs = writer->chunkTimestampUs;
+	chunk.codec = writer->cfg.codec;
+	chunk.channelCount = writer->channelCount;
+	for (c = 0; c < writer->channelCount; c++) {
+		const uint16_t *column = &writer->cfg.chunkBuffer[(size_t) c * chunkFrames];
+		chunk.columnOffset[c] = offset;
+		if (writer->cfg.codec == RHS_REC_CODEC_DELTA) {
+			offset += rhs2116_recEncodeDelta(column, fill, NULL);
+		} else {
+			offset += fill * sizeof(uint16_t);
+		}
+	}
+	chunk.payloadBytes = offset;
+
+	if (writer->cfg.index != NULL && writer->chunkCount < writer->cfg.indexCapacity) {
+		Rhs2116_RecIndexEntry_t *entry = &writer->cfg.index[writer->chunkCount];
+		entry->firstFrame = writer->frameCount - fill;
+		entry->frameCounter = chunk.frameCounter;
+		entry->timestampUs = chunk.timestampUs;
+		entry->offset = writer->offset;
+	} else {
+		writer->indexOverflow = true;
+	}
+
+	if (!rec_emit(writer, &chunk, sizeof(chunk))) {
+		return false;
+	}
+	for (c = 0; c < writer->channelCount; c++) {
+		const uint16_t *column = &writer->cfg.chunkBuffer[(size_t) c * chunkFrames];
+		if (writer->cfg.codec == RHS_REC_CODEC_DELTA) {
+			if (!rec_emitDeltaColumn(writer, column, fill)) {
+				return false;
+			}
+		} else if (!rec_emit(writer, column, fill * sizeof(uint16_t))) {
+			return false;
+		}
+	}
+
+	writer->chunkCount++;
+	writer->chunkFill = 0;
+	return rec_pad(writer);
+}
+
+/*
+ * Flushes the last chunk and writes the index and footer. If the caller's index
+ * array was too small the footer carries no index and readers fall back to
+ * scanning chunk headers.
+ */
+bool rhs2116_recWriterEnd(Rhs2116_RecWriter_t *writer) {
+	Rhs2116_RecFooter_t footer;
+
+	if (!rhs2116_recWriterFlush(writer)) {
+		return false;
+	}
+
+	memset(&footer, 0, sizeof(footer));
+	footer.magic = RHS_REC_INDEX_MAGIC;
+	footer.chunkCount = writer->chunkCount;
+	footer.frameCount = writer->frameCount;
+	if (writer->cfg.index != NULL && !writer->indexOverflow) {
+		footer.indexOffset = writer->offset;
+		if (!rec_emit(writer, writer->cfg.index,
+				(size_t) writer->chunkCount * sizeof(Rhs2116_RecIndexEntry_t))) {
+			return false;
+		}
+	}
+	return rec_emit(writer, &footer, sizeof(footer));
+}
@@ -0,0 +1,164 @@
+/***************************************************************************//**
+ * @file rhs2116_record.h
+ * @brief Chunked, indexed recording container for RHS2116 acquisition frames
+ ******************************************************************************/
+
+#ifndef RHS2116_RECORD_H
+#define RHS2116_RECORD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * File layout (all fields little-endian):
+ *   Rhs2116_RecHeader_t
+ *   chunk 0: Rhs2116_RecChunkHeader_t + payload (padded to 8 bytes)
+ *   chunk 1: ...
+ *   Rhs2116_RecIndexEntry_t[chunkCount]
+ *   Rhs2116_RecFooter_t
+ *
+ * Every chunk holds up to chunkFrames consecutive frames (frame counters with no
+ * gaps) stored channel-planar, so a channel range is a contiguous slice of the
+ * payload. The index at the end of the file gives the first frame, frame counter,
+ * timestamp and file offset of each chunk; a file without an index (e.g. the
+ * writer was interrupted) is still readable by walking the chunk headers.
+ */
+#define RHS_REC_MAGIC "RHS2REC"
+#define RHS_REC_CHUNK_MAGIC 0x4B434852 // "RHCK"
+#define RHS_REC_INDEX_MAGIC 0x58494852 // "RHIX"
+#define RHS_REC_VERSION 1
+#define RHS_REC_MAX_CHANNELS 16
+
+#define RHS_REC_CODEC_RAW 0	  // uint16 samples
+#define RHS_REC_CODEC_DELTA 1 // zigzag varint of the difference to the previous sample
+
+typedef struct
+{
+	char magic[8];		   // RHS_REC_MAGIC, NUL terminated
+	uint16_t version;	   // RHS_REC_VERSION
+	uint16_t channelCount; // channels per frame (1-16)
+	uint32_t chunkFrames;  // frames per chunk (the last chunk may be shorter)
+	uint32_t sampleRateHz; // per-channel sample rate
+	uint16_t channelMask;  // chip channels present, lowest set bit first (RHS_ACAMP_PWR layout)
+	uint16_t codec;		   // RHS_REC_CODEC_*
+	uint32_t reserved[2];
+} Rhs2116_RecHeader_t;
+
+typedef struct
+{
+	uint32_t magic;		   // RHS_REC_CHUNK_MAGIC
+	uint32_t frameCount;   // frames in this chunk
+	uint64_t frameCounter; // frame counter of the first frame
+	uint64_t timestampUs;  // timestamp of the first frame
+	uint32_t payloadBytes; // payload size, excluding padding
+	uint16_t codec;		   // RHS_REC_CODEC_*
+	uint16_t channelCount;
+	uint32_t columnOffset[RHS_REC_MAX_CHANNELS]; // start of each channel column within the payload
+} Rhs2116_RecChunkHeader_t;
+
+typedef struct
+{
+	uint64_t firstFrame;   // position of the chunk's first frame in the recording
+	uint64_t frameCounter; // frame counter of the chunk's first frame
+	uint64_t timestampUs;  // timestamp of the chunk's first frame
+	uint64_t offset;	   // file offset of the chunk header
+} Rhs2116_RecIndexEntry_t;
+
+typedef struct
+{
+	uint64_t indexOffset; // file offset of the index, 0 if the writer could not keep one
+	uint64_t chunkCount;
+	uint64_t frameCount;
+	uint32_t magic; // RHS_REC_INDEX_MAGIC
+	uint32_t reserved;
+} Rhs2116_RecFooter_t;
+
+/*
+ * Destination of the streaming writer (file, SD card, socket...). Must write all
+ * len bytes and return true, or return false to abort the recording.
+ */
+typedef bool (*Rhs2116_RecSink_t)(void *ctx, const void *data, size_t len);
+
+typedef struct
+{
+	Rhs2116_RecSink_t sink;
+	void *sinkCtx;
+	uint16_t channelMask;  // chip channels in every frame
+	uint32_t sampleRateHz;
+	uint32_t chunkFrames;
+	uint16_t codec;		   // RHS_REC_CODEC_*
+	uint16_t *chunkBuffer; // chunkFrames * channels samples, owned by the caller
+	Rhs2116_RecIndexEntry_t *index; // optional, indexCapacity entries, owned by the caller
+	uint32_t indexCapacity;
+} Rhs2116_RecConfig_t;
+
+typedef struct
+{
+	Rhs2116_RecConfig_t cfg;
+	uint16_t channelCount;
+	uint32_t chunkFill;		   // frames buffered in the current chunk
+	uint64_t chunkFrameCounter; // first frame counter of the current chunk
+	uint64_t chunkTimestampUs;
+	uint64_t frameCount; // frames written so far, including the current chunk
+	uint64_t chunkCount;
+	uint64_t offset; // bytes handed to the sink so far
+	bool indexOverflow;
+	bool ok;
+} Rhs2116_RecWriter_t;
+
+bool rhs2116_recWriterBegin(Rhs2116_RecWriter_t *writer, const Rhs2116_RecConfig_t *cfg);
+bool rhs2116_recWriterAppend(Rhs2116_RecWriter_t *writer, uint64_t frameCounter,
+							 uint64_t timestampUs, const uint16_t *samples, uint32_t frameCount);
+bool rhs2116_recWriterFlush(Rhs2116_RecWriter_t *writer);
+bool rhs2116_recWriterEnd(Rhs2116_RecWriter_t *writer);
+
+/*
+ * Host-side reader (rhs2116_record_reader.c, POSIX). Memory-maps the file; every
+ * seek is a binary search over the chunk index.
+ */
+typedef struct
+{
+	const uint8_t *base;
+	size_t size;
+	const Rhs2116_RecHeader_t *header;
+	const Rhs2116_RecIndexEntry_t *index;
+	uint64_t chunkCount;
+	uint64_t frameCount;
+	bool ownsIndex; // index was rebuilt by scanning and must be freed
+} Rhs2116_RecReader_t;
+
+bool rhs2116_recOpen(Rhs2116_RecReader_t *reader, const char *path);
+void rhs2116_recClose(Rhs2116_RecReader_t *reader);
+uint64_t rhs2116_recSeekTime(const Rhs2116_RecReader_t *reader, uint64_t timestampUs);
+uint64_t rhs2116_recSeekFrameCounter(const Rhs2116_RecReader_t *reader, uint64_t frameCounter);
+uint32_t rhs2116_recRead(const Rhs2116_RecReader_t *reader, uint64_t firstFrame, uint32_t frameCount,
+						 uint8_t firstChannel, uint8_t channelCount, uint16_t *samples);
+
+/*
+ * Sequential reader over all channels. Keeps each column's decoder state, so
+ * consecutive reads cost O(1) per sample however large the chunks are; only
+ * rhs2116_recCursorSeek() decodes from the start of a chunk.
+ */
+typedef struct
+{
+	const Rhs2116_RecReader_t *reader;
+	const Rhs2116_RecChunkHeader_t *header; // current chunk, NULL when past the end
+	uint64_t chunk;
+	uint64_t frame;	   // position of the next frame to be read
+	uint32_t chunkPos; // frames of the current chunk already consumed
+	size_t pos[RHS_REC_MAX_CHANNELS]; // delta codec: byte position in each column
+	uint16_t previous[RHS_REC_MAX_CHANNELS];
+} Rhs2116_RecCursor_t;
+
+bool rhs2116_recCursorSeek(Rhs2116_RecCursor_t *cursor, const Rhs2116_RecReader_t *reader,
+						   uint64_t frame);
+uint32_t rhs2116_recCursorRead(Rhs2116_RecCursor_t *cursor, uint32_t frameCount, uint16_t *samples);
+
+size_t rhs2116_recEncodeDelta(const uint16_t *column, uint32_t count, uint8_t *out);
+bool rhs2116_recDecodeDelta(const uint8_t *in, size_t len, uint32_t skip, uint32_t count,
+							uint16_t *out, size_t stride);
+bool rhs2116_recDecodeDeltaNext(const uint8_t *in, size_t len, size_t *pos, uint16_t *previous,
+								uint32_t count, uint16_t *out, size_t stride);
+
+#endif // RHS2116_RECORD_H
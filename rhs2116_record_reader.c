@@ -0,0 +1,426 @@
+/***************************************************************************//**
+ * @file rhs2116_record_reader.c
+ * @brief Memory-mapped reader for RHS2116 recordings (host side, POSIX)
+ ******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "rhs2116_record.h"
+
+static const Rhs2116_RecChunkHeader_t *rec_chunkAt(const Rhs2116_RecReader_t *reader,
+		uint64_t offset) {
+	const Rhs2116_RecChunkHeader_t *chunk;
+
+	// offset may come from an untrusted index entry; compare without adding to it
+	if (offset % 8 != 0 || offset > reader->size || sizeof(*chunk) > reader->size - offset) {
+		return NULL;
+	}
+	chunk = (const Rhs2116_RecChunkHeader_t *) (reader->base + offset);
+	if (chunk->magic != RHS_REC_CHUNK_MAGIC
+			|| chunk->channelCount != reader->header->channelCount
+			|| chunk->payloadBytes > reader->size - offset - sizeof(*chunk)) {
+		return NULL;
+	}
+	return chunk;
+}
+
+/*
+ * Rebuilds the index of a recording that has no footer or whose writer ran out
+ * of index space. Only chunk headers are touched, never the payload.
+ */
+static bool rec_scanIndex(Rhs2116_RecReader_t *reader) {
+	Rhs2116_RecIndexEntry_t *index = NULL;
+	uint64_t capacity = 0;
+	uint64_t count = 0;
+	uint64_t frames = 0;
+	uint64_t offset = sizeof(Rhs2116_RecHeader_t);
+	const Rhs2116_RecChunkHeader_t *chunk;
+
+	while ((chunk = rec_chunkAt(reader, offset)) != NULL) {
+		if (count == capacity) {
+			Rhs2116_RecIndexEntry_t *grown;
+			capacity = capacity ? capacity * 2 : 64;
+			grown = realloc(index, capacity * sizeof(*index));
+			if (grown == NULL) {
+				free(index);
+				return false;
+			}
+			index = grown;
+		}
+		index[count].firstFrame = frames;
+		index[count].frameCounter = chunk->frameCounter;
+		index[count].timestampUs = chunk->timestampUs;
+		index[count].offset = offset;
+		count++;
+		frames += chunk->frameCount;
+		offset += (sizeof(*chunk) + chunk->payloadBytes + 7) & ~(uint64_t) 7;
+	}
+
+	reader->index = index;
+	reader->chunkCount = count;
+	reader->frameCount = frames;
+	reader->ownsIndex = true;
+	return true;
+}
+
+/*
+ * Seeks, reads and the cursor trust the index, so every entry must point at a
+ * chunk header whose frameCount spans exactly up to the next entry's firstFrame
+ * (or frameCount for the last one), starting from frame 0. This also rules out
+ * empty chunks, which would make rec_chunkFrames() return 0.
+ */
+static bool rec_indexValid(const Rhs2116_RecReader_t *reader) {
+	uint64_t i;
+
+	if (reader->chunkCount > 0 && reader->index[0].firstFrame != 0) {
+		return false;
+	}
+	for (i = 0; i < reader->chunkCount; i++) {
+		const Rhs2116_RecChunkHeader_t *chunk = rec_chunkAt(reader, reader->index[i].offset);
+		uint64_t end = (i + 1 < reader->chunkCount) ?
+				reader->index[i + 1].firstFrame : reader->frameCount;
+
+		if (chunk == NULL || chunk->frameCount == 0 || end <= reader->index[i].firstFrame
+				|| end - reader->index[i].firstFrame != chunk->frameCount) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool rhs2116_recOpen(Rhs2116_RecReader_t *reader, const char *path) {
+	const Rhs2116_RecFooter_t *footer = NULL;
+	struct stat st;
+	void *map;
+	int fd;
+
+	memset(reader, 0, sizeof(*reader));
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(Rhs2116_RecHeader_t)) {
+		close(fd);
+		return false;
+	}
+	map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+
+	reader->base = map;
+	reader->size = (size_t) st.st_size;
+	reader->header = (const Rhs2116_RecHeader_t *) reader->base;
+
+	if (memcmp(reader->header->magic, RHS_REC_MAGIC, sizeof(RHS_REC_MAGIC)) != 0
+			|| reader->header->version != RHS_REC_VERSION
+			|| reader->header->channelCount == 0
+			|| reader->header->channelCount > RHS_REC_MAX_CHANNELS) {
+		rhs2116_recClose(reader);
+		return false;
+	}
+
+	if (reader->size >= sizeof(Rhs2116_RecHeader_t) + sizeof(Rhs2116_RecFooter_t)) {
+		footer = (const Rhs2116_RecFooter_t *) (reader->base + reader->size - sizeof(*footer));
+		if (footer->magic != RHS_REC_INDEX_MAGIC || footer->indexOffset == 0
+				|| footer->indexOffset % 8 != 0
+				|| footer->indexOffset > reader->size - sizeof(*footer)
+				|| footer->chunkCount > (reader->size - sizeof(*footer) - footer->indexOffset)
+						/ sizeof(Rhs2116_RecIndexEntry_t)) {
+			footer = NULL;
+		}
+	}
+
+	if (footer != NULL) {
+		reader->index = (const Rhs2116_RecIndexEntry_t *) (reader->base + footer->indexOffset);
+		reader->chunkCount = footer->chunkCount;
+		reader->frameCount = footer->frameCount;
+	} else if (!rec_scanIndex(reader)) {
+		rhs2116_recClose(reader);
+		return false;
+	}
+	if (!rec_indexValid(reader)) {
+		rhs2116_recClose(reader);
+		return false;
+	}
+	return true;
+}
+
+void rhs2116_recClose(Rhs2116_RecReader_t *reader) {
+	if (reader->ownsIndex) {
+		free((void *) reader->index);
+	}
+	if (reader->base != NULL) {
+		munmap((void *) reader->base, reader->size);
+	}
+	memset(reader, 0, sizeof(*reader));
+}
+
+/*
+ * Binary searches for the last chunk whose key is <= value. Keys are the index
+ * field at byte offset keyOffset (firstFrame, frameCounter or timestampUs).
+ */
+static uint64_t rec_findChunk(const Rhs2116_RecReader_t *reader, size_t keyOffset,
+		uint64_t value) {
+	uint64_t lo = 0;
+	uint64_t hi = reader->chunkCount;
+
+	while (hi - lo > 1) {
+		uint64_t mid = lo + (hi - lo) / 2;
+		uint64_t key;
+		memcpy(&key, (const uint8_t *) &reader->index[mid] + keyOffset, sizeof(key));
+		if (key <= value) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+static uint32_t rec_chunkFrames(const Rhs2116_RecReader_t *reader, uint64_t chunk) {
+	uint64_t end = (chunk + 1 < reader->chunkCount) ?
+			reader->index[chunk + 1].firstFrame : reader->frameCount;
+	return (uint32_t) (end - reader->index[chunk].firstFrame);
+}
+
+/*
+ * Returns the position of the frame acquired at (or just before) timestampUs.
+ */
+uint64_t rhs2116_recSeekTime(const Rhs2116_RecReader_t *reader, uint64_t timestampUs) {
+	const Rhs2116_RecIndexEntry_t *entry;
+	uint64_t chunk;
+	uint64_t frame = 0;
+
+	if (reader->chunkCount == 0) {
+		return 0;
+	}
+	chunk = rec_findChunk(reader, offsetof(Rhs2116_RecIndexEntry_t, timestampUs), timestampUs);
+	entry = &reader->index[chunk];
+	if (timestampUs > entry->timestampUs) {
+		frame = (timestampUs - entry->timestampUs) * reader->header->sampleRateHz / 1000000;
+		if (frame >= rec_chunkFrames(reader, chunk)) {
+			frame = rec_chunkFrames(reader, chunk) - 1;
+		}
+	}
+	return entry->firstFrame + frame;
+}
+
+/*
+ * Returns the position of the frame with the given frame counter, or of the last
+ * frame recorded before it if that counter fell into a gap.
+ */
+uint64_t rhs2116_recSeekFrameCounter(const Rhs2116_RecReader_t *reader, uint64_t frameCounter) {
+	const Rhs2116_RecIndexEntry_t *entry;
+	uint64_t chunk;
+	uint64_t frame = 0;
+
+	if (reader->chunkCount == 0) {
+		return 0;
+	}
+	chunk = rec_findChunk(reader, offsetof(Rhs2116_RecIndexEntry_t, frameCounter), frameCounter);
+	entry = &reader->index[chunk];
+	if (frameCounter > entry->frameCounter) {
+		frame = frameCounter - entry->frameCounter;
+		if (frame >= rec_chunkFrames(reader, chunk)) {
+			frame = rec_chunkFrames(reader, chunk) - 1;
+		}
+	}
+	return entry->firstFrame + frame;
+}
+
+/*
+ * Copies frames [firstFrame, firstFrame + frameCount) of channels
+ * [firstChannel, firstChannel + channelCount) into samples, frame-interleaved.
+ * Channel numbers are positions within the recording, not chip channels.
+ * Returns the number of frames copied.
+ */
+uint32_t rhs2116_recRead(const Rhs2116_RecReader_t *reader, uint64_t firstFrame, uint32_t frameCount,
+		uint8_t firstChannel, uint8_t channelCount, uint16_t *samples) {
+	uint32_t done = 0;
+	uint64_t chunk;
+
+	if (firstFrame >= reader->frameCount || channelCount == 0
+			|| firstChannel + channelCount > reader->header->channelCount) {
+		return 0;
+	}
+	if (frameCount > reader->frameCount - firstFrame) {
+		frameCount = (uint32_t) (reader->frameCount - firstFrame);
+	}
+
+	chunk = rec_findChunk(reader, offsetof(Rhs2116_RecIndexEntry_t, firstFrame), firstFrame);
+	while (done < frameCount && chunk < reader->chunkCount) {
+		const Rhs2116_RecChunkHeader_t *header = rec_chunkAt(reader, reader->index[chunk].offset);
+		const uint8_t *payload;
+		uint32_t skip = (uint32_t) (firstFrame + done - reader->index[chunk].firstFrame);
+		uint32_t count;
+		uint8_t c;
+
+		if (header == NULL || skip >= header->frameCount) {
+			break;
+		}
+		payload = (const uint8_t *) (header + 1);
+		count = header->frameCount - skip;
+		if (count > frameCount - done) {
+			count = frameCount - done;
+		}
+
+		for (c = 0; c < channelCount; c++) {
+			uint8_t column = firstChannel + c;
+			uint32_t start = header->columnOffset[column];
+			uint32_t end = (column + 1 < header->channelCount) ?
+					header->columnOffset[column + 1] : header->payloadBytes;
+			uint16_t *out = &samples[(size_t) done * channelCount + c];
+
+			if (start > end || end > header->payloadBytes) {
+				return done;
+			}
+			if (header->codec == RHS_REC_CODEC_DELTA) {
+				if (!rhs2116_recDecodeDelta(payload + start, end - start, skip, count, out,
+						channelCount)) {
+					return done;
+				}
+			} else {
+				const uint8_t *in = payload + start + (size_t) skip * sizeof(uint16_t);
+				uint32_t i;
+				if ((size_t) (skip + count) * sizeof(uint16_t) > end - start) {
+					return done;
+				}
+				for (i = 0; i < count; i++) {
+					memcpy(&out[(size_t) i * channelCount], in + (size_t) i * sizeof(uint16_t),
+							sizeof(uint16_t));
+				}
+			}
+		}
+		done += count;
+		chunk++;
+	}
+	return done;
+}
+
+// Locates column c of a chunk's payload; false if the header is inconsistent
+static bool rec_column(const Rhs2116_RecChunkHeader_t *header, uint16_t c, const uint8_t **in,
+		size_t *len) {
+	uint32_t start = header->columnOffset[c];
+	uint32_t end = (c + 1 < header->channelCount) ?
+			header->columnOffset[c + 1] : header->payloadBytes;
+
+	if (start > end || end > header->payloadBytes) {
+		return false;
+	}
+	*in = (const uint8_t *) (header + 1) + start;
+	*len = end - start;
+	return true;
+}
+
+// Makes chunk the cursor's current chunk, positioned skip frames into it
+static bool rec_cursorEnter(Rhs2116_RecCursor_t *cursor, uint64_t chunk, uint32_t skip) {
+	const Rhs2116_RecReader_t *reader = cursor->reader;
+	const Rhs2116_RecChunkHeader_t *header = NULL;
+	uint16_t c;
+
+	cursor->header = NULL;
+	cursor->chunk = chunk;
+	cursor->chunkPos = skip;
+	if (chunk >= reader->chunkCount) {
+		return false;
+	}
+	header = rec_chunkAt(reader, reader->index[chunk].offset);
+	if (header == NULL || skip >= header->frameCount) {
+		return false;
+	}
+
+	for (c = 0; c < header->channelCount; c++) {
+		const uint8_t *in;
+		size_t len;
+
+		cursor->pos[c] = 0;
+		cursor->previous[c] = 0;
+		if (!rec_column(header, c, &in, &len)) {
+			return false;
+		}
+		if (header->codec == RHS_REC_CODEC_DELTA) {
+			if (!rhs2116_recDecodeDeltaNext(in, len, &cursor->pos[c], &cursor->previous[c],
+					skip, NULL, 0)) {
+				return false;
+			}
+		} else if ((size_t) header->frameCount * sizeof(uint16_t) > len) {
+			return false;
+		}
+	}
+	cursor->header = header;
+	return true;
+}
+
+bool rhs2116_recCursorSeek(Rhs2116_RecCursor_t *cursor, const Rhs2116_RecReader_t *reader,
+		uint64_t frame) {
+	uint64_t chunk;
+
+	memset(cursor, 0, sizeof(*cursor));
+	cursor->reader = reader;
+	cursor->frame = frame;
+	if (frame >= reader->frameCount) {
+		return false;
+	}
+	chunk = rec_findChunk(reader, offsetof(Rhs2116_RecIndexEntry_t, firstFrame), frame);
+	return rec_cursorEnter(cursor, chunk, (uint32_t) (frame - reader->index[chunk].firstFrame));
+}
+
+/*
+ * Copies the next frameCount frames of every channel into samples,
+ * frame-interleaved, continuing where the previous read stopped. Returns the
+ * number of frames copied.
+ */
+uint32_t rhs2116_recCursorRead(Rhs2116_RecCursor_t *cursor, uint32_t frameCount, uint16_t *samples) {
+	uint32_t done = 0;
+
+	while (done < frameCount && cursor->header != NULL) {
+		const Rhs2116_RecChunkHeader_t *header = cursor->header;
+		const uint16_t channels = header->channelCount;
+		uint32_t count = header->frameCount - cursor->chunkPos;
+		uint16_t c;
+
+		if (count > frameCount - done) {
+			count = frameCount - done;
+		}
+		for (c = 0; c < channels; c++) {
+			uint16_t *out = &samples[(size_t) done * channels + c];
+			const uint8_t *in;
+			size_t len;
+			uint32_t i;
+
+			if (!rec_column(header, c, &in, &len)) {
+				cursor->header = NULL;
+				return done;
+			}
+			if (header->codec == RHS_REC_CODEC_DELTA) {
+				if (!rhs2116_recDecodeDeltaNext(in, len, &cursor->pos[c], &cursor->previous[c],
+						count, out, channels)) {
+					cursor->header = NULL;
+					return done;
+				}
+			} else {
+				in += (size_t) cursor->chunkPos * sizeof(uint16_t);
+				for (i = 0; i < count; i++) {
+					memcpy(&out[(size_t) i * channels], in + (size_t) i * sizeof(uint16_t),
+							sizeof(uint16_t));
+				}
+			}
+		}
+
+		cursor->chunkPos += count;
+		cursor->frame += count;
+		done += count;
+		if (cursor->chunkPos == header->frameCount) {
+			rec_cursorEnter(cursor, cursor->chunk + 1, 0);
+		}
+	}
+	return done;
+}
@@ -0,0 +1,173 @@
+/***************************************************************************//**
+ * @file rhs2116_replay.c
+ * @brief Deterministic replay of recorded sessions through the RHS2116 driver
+ ******************************************************************************/
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "rhs2116_replay.h"
+
+static uint64_t replay_nowNs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+/*
+ * Holds the caller until the next frame's slot at the recorded sample rate. Slots
+ * count from the first CONVERT, so setup traffic before it is not banked.
+ */
+static void replay_pace(const Rhs2116_Replay_t *replay) {
+	uint64_t due;
+	struct timespec ts;
+
+	if (replay->reader->header->sampleRateHz == 0 || replay->framesServed == 0) {
+		return;
+	}
+	due = replay->startNs
+			+ replay->framesServed * 1000000000u / replay->reader->header->sampleRateHz;
+	ts.tv_sec = (time_t) (due / 1000000000u);
+	ts.tv_nsec = (long) (due % 1000000000u);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+		;
+}
+
+static uint16_t replay_sample(Rhs2116_Replay_t *replay, uint8_t channel) {
+	const uint16_t channels = replay->reader->header->channelCount;
+	int8_t column = replay->chipToColumn[channel & 0x3F];
+
+	if (column < 0 || replay->done) {
+		return 0;
+	}
+	if (replay->frame < replay->blockFrame
+			|| replay->frame >= replay->blockFrame + replay->blockCount) {
+		// Sequential refills continue the cursor; only a jump (start, loop) seeks
+		if (replay->cursor.reader == NULL || replay->cursor.frame != replay->frame) {
+			rhs2116_recCursorSeek(&replay->cursor, replay->reader, replay->frame);
+		}
+		replay->blockFrame = replay->frame;
+		replay->blockCount = rhs2116_recCursorRead(&replay->cursor, RHS_REPLAY_BLOCK_FRAMES,
+				replay->block);
+		if (replay->blockCount == 0) {
+			replay->done = true;
+			return 0;
+		}
+	}
+	return replay->block[(size_t) (replay->frame - replay->blockFrame) * channels + column];
+}
+
+bool rhs2116_replayInit(Rhs2116_Replay_t *replay, const Rhs2116_RecReader_t *reader,
+		uint64_t firstFrame, Rhs2116_ReplayMode_t mode, bool loop) {
+	uint8_t channel;
+	int8_t column = 0;
+
+	memset(replay, 0, sizeof(*replay));
+	if (reader->header == NULL || firstFrame >= reader->frameCount) {
+		return false;
+	}
+
+	replay->reader = reader;
+	replay->mode = mode;
+	replay->loop = loop;
+	replay->firstFrame = firstFrame;
+	replay->frame = firstFrame;
+	replay->lastChannel = -1;
+	for (channel = 0; channel < 64; channel++) {
+		replay->chipToColumn[channel] = -1;
+		if (channel < 16 && (reader->header->channelMask & (1u << channel))) {
+			replay->chipToColumn[channel] = column++;
+		}
+	}
+
+	// Power-on register file; CLEAR and the init sequence fill in the rest
+	replay->regs[RHS_NCH] = 16;
+	replay->regs[RHS_CHIP_ID] = CHIP_ID;
+	return true;
+}
+
+void rhs2116_replayTransport(Rhs2116_Replay_t *replay, Rhs2116_Transport_t *transport) {
+	transport->command = rhs2116_replayCommand;
+	transport->batch = NULL;
+	transport->ctx = replay;
+}
+
+void rhs2116_replayNextFrame(Rhs2116_Replay_t *replay) {
+	replay->lastChannel = -1;
+	replay->frame++;
+	if (replay->frame >= replay->reader->frameCount) {
+		if (replay->loop) {
+			replay->frame = replay->firstFrame;
+		} else {
+			replay->done = true;
+		}
+	}
+	if (replay->mode == RHS_REPLAY_REALTIME && !replay->done) {
+		replay_pace(replay);
+	}
+}
+
+bool rhs2116_replayDone(const Rhs2116_Replay_t *replay) {
+	return replay->done;
+}
+
+/*
+ * Transport entry point. Decodes the command the way the chip would and returns
+ * its MISO word: WRITE echoes the data, READ returns the register model, and
+ * CONVERT returns the recorded sample as the AC result (first two bytes) with a
+ * mid-scale DC result.
+ */
+uint32_t rhs2116_replayCommand(void *ctx, uint32_t txWord) {
+	Rhs2116_Replay_t *replay = ctx;
+	uint8_t command = txWord & 0xFF;
+	uint8_t reg = (txWord >> 8) & 0xFF;
+	uint16_t data = (uint16_t) (((txWord >> 8) & 0xFF00) | ((txWord >> 24) & 0x00FF));
+	uint16_t value;
+
+	replay->commands++;
+
+	switch (command & 0xC0) {
+	case 0x00: // CONVERT
+		if ((int16_t) (reg & 0x3F) <= replay->lastChannel) {
+			rhs2116_replayNextFrame(replay);
+		}
+		if (replay->lastChannel < 0 && !replay->done) {
+			if (replay->framesServed == 0) {
+				replay->startNs = replay_nowNs();
+			}
+			replay->framesServed++;
+		}
+		replay->lastChannel = reg & 0x3F;
+		replay->converts++;
+		value = replay_sample(replay, reg);
+		return ((uint32_t) (value >> 8) | ((uint32_t) (value & 0xFF) << 8)
+				| ((uint32_t) (RHS_REPLAY_DC_MIDSCALE >> 8) << 16)
+				| ((uint32_t) (RHS_REPLAY_DC_MIDSCALE & 0xFF) << 24));
+	case 0x80: // WRITE
+		if (reg < RHS_COMP_IN && reg != RHS_COMPL_MON && reg != RHS_FAULT_CUR_DET) {
+			replay->regs[reg] = data;
+		}
+		return 0x0000FFFF | ((uint32_t) (data & 0xFF) << 24) | ((uint32_t) (data >> 8) << 16);
+	case 0xC0: // READ
+		value = replay->regs[reg];
+		if (command & 0x10) { // M flag clears the compliance monitor
+			replay->regs[RHS_COMPL_MON] = 0;
+		}
+		return ((uint32_t) (value & 0xFF) << 24) | ((uint32_t) (value >> 8) << 16);
+	default: // CLEAR
+		return 0;
+	}
+}
+
+void rhs2116_replayStats(const Rhs2116_Replay_t *replay, Rhs2116_ReplayStats_t *stats) {
+	uint64_t elapsedNs = replay->framesServed ? replay_nowNs() - replay->startNs : 0;
+
+	stats->frames = replay->framesServed;
+	stats->commands = replay->commands;
+	stats->converts = replay->converts;
+	stats->elapsedSeconds = (double) elapsedNs / 1e9;
+	stats->framesPerSecond = elapsedNs ? (double) replay->framesServed / stats->elapsedSeconds : 0.0;
+	stats->realtimeFactor = replay->reader->header->sampleRateHz ?
+			stats->framesPerSecond / replay->reader->header->sampleRateHz : 0.0;
+}
@@ -0,0 +1,69 @@
+/***************************************************************************//**
+ * @file rhs2116_replay.h
+ * @brief Deterministic replay of recorded sessions through the RHS2116 driver
+ ******************************************************************************/
+
+#ifndef RHS2116_REPLAY_H
+#define RHS2116_REPLAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rhs2116.h"
+#include "rhs2116_record.h"
+
+#define RHS_REPLAY_BLOCK_FRAMES 256 // frames decoded from the recording at a time
+#define RHS_REPLAY_DC_MIDSCALE 0x0200 // 10-bit DC amplifier result served alongside each sample
+
+typedef enum
+{
+	RHS_REPLAY_FAST,	 // serve frames as fast as the caller converts
+	RHS_REPLAY_REALTIME	 // hold each frame until its slot at the recorded sample rate
+} Rhs2116_ReplayMode_t;
+
+/*
+ * Replay backend: a register-level model of the chip whose CONVERT results come
+ * from a recording. A frame is one sweep over the recorded channels; the next
+ * frame is served as soon as a channel is converted again (channel number not
+ * above the previous conversion), or on rhs2116_replayNextFrame().
+ * Host only: build the driver with RHS2116_HOST defined.
+ */
+typedef struct
+{
+	const Rhs2116_RecReader_t *reader;
+	Rhs2116_ReplayMode_t mode;
+	bool loop;
+	uint64_t firstFrame; // position the session (re)starts from
+	uint64_t frame;		 // position of the frame being served
+	Rhs2116_RecCursor_t cursor; // sequential decoder feeding block
+	uint64_t blockFrame; // position of block[0]
+	uint32_t blockCount; // frames valid in block
+	uint16_t block[RHS_REPLAY_BLOCK_FRAMES * RHS_REC_MAX_CHANNELS];
+	int8_t chipToColumn[64]; // recording column of each chip channel, -1 if not recorded
+	int16_t lastChannel;
+	bool done;
+	uint16_t regs[256];
+	uint64_t startNs;	   // time of the first CONVERT, when pacing and stats start
+	uint64_t framesServed; // frames that received at least one CONVERT
+	uint64_t commands;
+	uint64_t converts;
+} Rhs2116_Replay_t;
+
+typedef struct
+{
+	uint64_t frames;
+	uint64_t commands;
+	uint64_t converts;
+	double elapsedSeconds;
+	double framesPerSecond;
+	double realtimeFactor; // recorded sample rate multiples achieved
+} Rhs2116_ReplayStats_t;
+
+bool rhs2116_replayInit(Rhs2116_Replay_t *replay, const Rhs2116_RecReader_t *reader,
+						uint64_t firstFrame, Rhs2116_ReplayMode_t mode, bool loop);
+void rhs2116_replayTransport(Rhs2116_Replay_t *replay, Rhs2116_Transport_t *transport);
+uint32_t rhs2116_replayCommand(void *ctx, uint32_t txWord);
+void rhs2116_replayNextFrame(Rhs2116_Replay_t *replay);
+bool rhs2116_replayDone(const Rhs2116_Replay_t *replay);
+void rhs2116_replayStats(const Rhs2116_Replay_t *replay, Rhs2116_ReplayStats_t *stats);
+
+#endif // RHS2116_REPLAY_H
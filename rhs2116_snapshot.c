@@ -0,0 +1,154 @@
+/***************************************************************************//**
+ * @file rhs2116_snapshot.c
+ * @brief Configuration snapshot/restore for brownout and hot-swap recovery
+ ******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "rhs2116_snapshot.h"
+
+// Writes: stim disable (2) + CLEAR + registers; reads: registers + chip ID; M-flag dummy
+#define RESTORE_COMMANDS (3 + 2 * RHS_SNAPSHOT_REGISTERS + 2)
+
+static const uint8_t snapshotRegisters[RHS_SNAPSHOT_REGISTERS] = {
+	RHS_SUPPS_BIASCURR, RHS_OUTFMT_DSP_AUXDIO, RHS_IMPCHK_CTRL, RHS_IMPCHK_DAC,
+	RHS_RH1_CUTOFF, RHS_RH2_CUTOFF, RHS_ARL_A_CUTOFF, RHS_ARL_B_CUTOFF,
+	RHS_ACAMP_PWR, RHS_AMP_FSTSETL, RHS_AMP_LCUTOFF,
+	RHS_STIM_CUR_STEP, RHS_STIM_BIAS_VOLTS, RHS_CHRG_REC_VOLTS, RHS_CHRG_REC_CUR_LIM,
+	RHS_DC_AMP_PWR, RHS_STIM_ON, RHS_STIM_POL, RHS_CHRG_RECOVER, RHS_CUR_LMT_CHRG_REC,
+	RHS_NEG_CUR_MAG_0, RHS_NEG_CUR_MAG_1, RHS_NEG_CUR_MAG_2, RHS_NEG_CUR_MAG_3,
+	RHS_NEG_CUR_MAG_4, RHS_NEG_CUR_MAG_5, RHS_NEG_CUR_MAG_6, RHS_NEG_CUR_MAG_7,
+	RHS_NEG_CUR_MAG_8, RHS_NEG_CUR_MAG_9, RHS_NEG_CUR_MAG_10, RHS_NEG_CUR_MAG_11,
+	RHS_NEG_CUR_MAG_12, RHS_NEG_CUR_MAG_13, RHS_NEG_CUR_MAG_14, RHS_NEG_CUR_MAG_15,
+	RHS_POS_CUR_MAG_0, RHS_POS_CUR_MAG_1, RHS_POS_CUR_MAG_2, RHS_POS_CUR_MAG_3,
+	RHS_POS_CUR_MAG_4, RHS_POS_CUR_MAG_5, RHS_POS_CUR_MAG_6, RHS_POS_CUR_MAG_7,
+	RHS_POS_CUR_MAG_8, RHS_POS_CUR_MAG_9, RHS_POS_CUR_MAG_10, RHS_POS_CUR_MAG_11,
+	RHS_POS_CUR_MAG_12, RHS_POS_CUR_MAG_13, RHS_POS_CUR_MAG_14, RHS_POS_CUR_MAG_15,
+	// Stimulation enable goes last so the stimulators are configured before they are armed
+	RHS_STIM_EN_A, RHS_STIM_EN_B,
+};
+
+static uint32_t tx_words[RESTORE_COMMANDS];
+static uint32_t rx_words[RESTORE_COMMANDS];
+
+static bool isTriggered(uint8_t regAddress) {
+	return regAddress == RHS_AMP_FSTSETL || regAddress == RHS_AMP_LCUTOFF
+			|| (regAddress >= RHS_STIM_ON && regAddress <= RHS_CUR_LMT_CHRG_REC)
+			|| regAddress >= RHS_NEG_CUR_MAG_0;
+}
+
+static uint32_t crc32(const uint8_t *data, size_t len) {
+	uint32_t crc = 0xFFFFFFFF;
+	size_t i;
+	uint8_t bit;
+
+	for (i = 0; i < len; i++) {
+		crc ^= data[i];
+		for (bit = 0; bit < 8; bit++) {
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+		}
+	}
+	return ~crc;
+}
+
+static uint16_t blobValue(const uint8_t *blob, uint8_t i) {
+	return (uint16_t) (blob[4 + 2 * i] | (blob[5 + 2 * i] << 8));
+}
+
+// Value a restore writes: the stored one, except that pulses and charge recovery stay off
+static uint16_t restoreValue(const uint8_t *blob, uint8_t i) {
+	switch (snapshotRegisters[i]) {
+	case RHS_STIM_ON:
+	case RHS_CHRG_RECOVER:
+	case RHS_CUR_LMT_CHRG_REC:
+		return 0x0000;
+	default:
+		return blobValue(blob, i);
+	}
+}
+
+/*
+ * Reads every writable register and the chip ID in one batch and serializes
+ * them into blob (RHS_SNAPSHOT_BYTES).
+ */
+bool rhs2116_snapshot(uint8_t *blob) {
+	uint32_t crc;
+	uint8_t i;
+
+	for (i = 0; i < RHS_SNAPSHOT_REGISTERS; i++) {
+		tx_words[i] = rhs2116_readCommand(snapshotRegisters[i], false, false);
+	}
+	tx_words[RHS_SNAPSHOT_REGISTERS] = rhs2116_readCommand(RHS_CHIP_ID, false, false);
+	rhs2116_commandBatch(tx_words, rx_words, RHS_SNAPSHOT_REGISTERS + 1);
+
+	blob[0] = RHS_SNAPSHOT_MAGIC;
+	blob[1] = RHS_SNAPSHOT_VERSION;
+	blob[2] = RHS_SNAPSHOT_REGISTERS;
+	blob[3] = (uint8_t) rhs2116_registerResult(rx_words[RHS_SNAPSHOT_REGISTERS]);
+	for (i = 0; i < RHS_SNAPSHOT_REGISTERS; i++) {
+		uint16_t value = rhs2116_registerResult(rx_words[i]);
+		blob[4 + 2 * i] = value & 0xFF;
+		blob[5 + 2 * i] = value >> 8;
+	}
+	crc = crc32(blob, RHS_SNAPSHOT_BYTES - 4);
+	for (i = 0; i < 4; i++) {
+		blob[RHS_SNAPSHOT_BYTES - 4 + i] = (uint8_t) (crc >> (8 * i));
+	}
+
+	return blob[3] == CHIP_ID;
+}
+
+bool rhs2116_snapshotValid(const uint8_t *blob) {
+	uint32_t crc = 0;
+	uint8_t i;
+
+	if (blob[0] != RHS_SNAPSHOT_MAGIC || blob[1] != RHS_SNAPSHOT_VERSION
+			|| blob[2] != RHS_SNAPSHOT_REGISTERS || blob[3] != CHIP_ID) {
+		return false;
+	}
+	for (i = 0; i < 4; i++) {
+		crc |= (uint32_t) blob[RHS_SNAPSHOT_BYTES - 4 + i] << (8 * i);
+	}
+	return crc == crc32(blob, RHS_SNAPSHOT_BYTES - 4);
+}
+
+/*
+ * Restores a snapshot in a single pipelined batch, following the rhs2116_init()
+ * order: disable stimulation, CLEAR, write every register (triggered ones with
+ * the U flag so they take effect immediately, stimulation enable last), then
+ * read everything back and clear the compliance monitor. Stimulation on and
+ * charge recovery switches are written as 0. Returns true only if the chip
+ * answers with the expected ID and every register reads back as written.
+ */
+bool rhs2116_restore(const uint8_t *blob) {
+	const uint8_t readBack = 3 + RHS_SNAPSHOT_REGISTERS;
+	uint8_t n = 0;
+	uint8_t i;
+
+	if (!rhs2116_snapshotValid(blob)) {
+		return false;
+	}
+
+	tx_words[n++] = rhs2116_writeCommand(RHS_STIM_EN_A, 0x0000, false, false);
+	tx_words[n++] = rhs2116_writeCommand(RHS_STIM_EN_B, 0x0000, false, false);
+	tx_words[n++] = RHS_CLEAR;
+	for (i = 0; i < RHS_SNAPSHOT_REGISTERS; i++) {
+		tx_words[n++] = rhs2116_writeCommand(snapshotRegisters[i], restoreValue(blob, i),
+				isTriggered(snapshotRegisters[i]), false);
+	}
+	for (i = 0; i < RHS_SNAPSHOT_REGISTERS; i++) {
+		tx_words[n++] = rhs2116_readCommand(snapshotRegisters[i], false, false);
+	}
+	tx_words[n++] = rhs2116_readCommand(RHS_CHIP_ID, false, false);
+	tx_words[n++] = rhs2116_readCommand(RHS_CHIP_ID, false, true); // Dummy with M flag
+	rhs2116_commandBatch(tx_words, rx_words, n);
+
+	if (rhs2116_registerResult(rx_words[readBack + RHS_SNAPSHOT_REGISTERS]) != CHIP_ID) {
+		return false;
+	}
+	for (i = 0; i < RHS_SNAPSHOT_REGISTERS; i++) {
+		if (rhs2116_registerResult(rx_words[readBack + i]) != restoreValue(blob, i)) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,33 @@
+/***************************************************************************//**
+ * @file rhs2116_snapshot.h
+ * @brief Configuration snapshot/restore for brownout and hot-swap recovery
+ ******************************************************************************/
+
+#ifndef RHS2116_SNAPSHOT_H
+#define RHS2116_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rhs2116.h"
+
+/*
+ * Blob layout (little-endian):
+ *   [0] RHS_SNAPSHOT_MAGIC  [1] RHS_SNAPSHOT_VERSION  [2] register count  [3] chip ID
+ *   register values, uint16 each, in the order of the snapshot register table
+ *   CRC-32 (IEEE 802.3) of all preceding bytes
+ *
+ * The blob keeps RHS_STIM_ON, RHS_CHRG_RECOVER and RHS_CUR_LMT_CHRG_REC as read,
+ * but rhs2116_restore() writes them as 0 and verifies 0: a restore never resumes
+ * a pulse or charge recovery that was in progress. Re-issuing them is up to the
+ * application once the restore succeeds.
+ */
+#define RHS_SNAPSHOT_MAGIC 0x52 // 'R'
+#define RHS_SNAPSHOT_VERSION 1
+#define RHS_SNAPSHOT_REGISTERS 54 // every writable static and triggered register
+#define RHS_SNAPSHOT_BYTES (4 + 2 * RHS_SNAPSHOT_REGISTERS + 4)
+
+bool rhs2116_snapshot(uint8_t *blob);
+bool rhs2116_snapshotValid(const uint8_t *blob);
+bool rhs2116_restore(const uint8_t *blob);
+
+#endif // RHS2116_SNAPSHOT_H
@@ -0,0 +1,192 @@
+/***************************************************************************//**
+ * @file rhs2116_spidev.c
+ * @brief Linux spidev transport for the RHS2116 driver
+ ******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+#include "rhs2116_spidev.h"
+
+static int spidev_ioctl(void *ctx, int fd, unsigned long request, void *arg) {
+	(void) ctx;
+	return ioctl(fd, request, arg);
+}
+
+// The driver's command words hold the first byte on the wire in bits 7:0
+static void spidev_putWord(uint8_t *bytes, uint32_t word) {
+	bytes[0] = (uint8_t) word;
+	bytes[1] = (uint8_t) (word >> 8);
+	bytes[2] = (uint8_t) (word >> 16);
+	bytes[3] = (uint8_t) (word >> 24);
+}
+
+static uint32_t spidev_getWord(const uint8_t *bytes) {
+	return (uint32_t) bytes[0] | ((uint32_t) bytes[1] << 8)
+			| ((uint32_t) bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
+
+static bool spidev_setup(Rhs2116_Spidev_t *dev) {
+	uint8_t mode = SPI_MODE_0;
+	uint8_t bits = 8;
+	size_t i;
+
+	if (dev->ioctl(dev->ioctlCtx, dev->fd, SPI_IOC_WR_MODE, &mode) < 0
+			|| dev->ioctl(dev->ioctlCtx, dev->fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0
+			|| dev->ioctl(dev->ioctlCtx, dev->fd, SPI_IOC_WR_MAX_SPEED_HZ, &dev->speedHz) < 0) {
+		return false;
+	}
+
+	// One transfer per frame, preset once; only the CS flag of the last one varies
+	memset(dev->transfers, 0, sizeof(dev->transfers));
+	for (i = 0; i < RHS_SPIDEV_MAX_FRAMES; i++) {
+		dev->transfers[i].tx_buf = (uintptr_t) &dev->txBytes[4 * i];
+		dev->transfers[i].rx_buf = (uintptr_t) &dev->rxBytes[4 * i];
+		dev->transfers[i].len = 4;
+		dev->transfers[i].speed_hz = dev->speedHz;
+		dev->transfers[i].bits_per_word = 8;
+		dev->transfers[i].cs_change = 1;
+	}
+	dev->ok = true;
+	return true;
+}
+
+bool rhs2116_spidevOpen(Rhs2116_Spidev_t *dev, const char *path, uint32_t speedHz) {
+	memset(dev, 0, sizeof(*dev));
+	dev->fd = open(path, O_RDWR);
+	if (dev->fd < 0) {
+		return false;
+	}
+	dev->speedHz = speedHz;
+	dev->ioctl = spidev_ioctl;
+	if (!spidev_setup(dev)) {
+		rhs2116_spidevClose(dev);
+		return false;
+	}
+	return true;
+}
+
+bool rhs2116_spidevAttach(Rhs2116_Spidev_t *dev, Rhs2116_SpidevIoctl_t ioctlFn, void *ioctlCtx,
+		uint32_t speedHz) {
+	memset(dev, 0, sizeof(*dev));
+	dev->fd = -1;
+	dev->speedHz = speedHz;
+	dev->ioctl = ioctlFn;
+	dev->ioctlCtx = ioctlCtx;
+	return spidev_setup(dev);
+}
+
+void rhs2116_spidevClose(Rhs2116_Spidev_t *dev) {
+	if (dev->fd >= 0 && dev->ioctl == spidev_ioctl) {
+		close(dev->fd);
+	}
+	dev->fd = -1;
+	dev->ok = false;
+}
+
+void rhs2116_spidevTransport(Rhs2116_Spidev_t *dev, Rhs2116_Transport_t *transport) {
+	transport->command = rhs2116_spidevCommand;
+	transport->batch = rhs2116_spidevBatch;
+	transport->ctx = dev;
+}
+
+// Sends frames [0, count) of txBytes in one SPI_IOC_MESSAGE
+static bool spidev_message(Rhs2116_Spidev_t *dev, size_t count) {
+	bool sent;
+
+	// cs_change on the last transfer would leave CS asserted after the message
+	dev->transfers[count - 1].cs_change = 0;
+	sent = dev->ioctl(dev->ioctlCtx, dev->fd, SPI_IOC_MESSAGE(count), dev->transfers) >= 0;
+	dev->transfers[count - 1].cs_change = 1;
+
+	dev->syscalls++;
+	dev->frames += count;
+	if (!sent) {
+		dev->ok = false;
+		memset(dev->rxBytes, 0, 4 * count);
+	}
+	return sent;
+}
+
+/*
+ * Streams the commands followed by RHS_PIPELINE_DEPTH flush frames,
+ * RHS_SPIDEV_MAX_FRAMES per ioctl; rxWords[i] is taken from the frame
+ * RHS_PIPELINE_DEPTH after txWords[i].
+ */
+void rhs2116_spidevBatch(void *ctx, const uint32_t *txWords, uint32_t *rxWords, size_t count) {
+	Rhs2116_Spidev_t *dev = ctx;
+	const uint32_t flushWord = rhs2116_flushCommand();
+	size_t total = count + RHS_PIPELINE_DEPTH;
+	size_t first;
+
+	for (first = 0; first < total; first += RHS_SPIDEV_MAX_FRAMES) {
+		size_t frames = total - first;
+		size_t i;
+
+		if (frames > RHS_SPIDEV_MAX_FRAMES) {
+			frames = RHS_SPIDEV_MAX_FRAMES;
+		}
+		for (i = 0; i < frames; i++) {
+			spidev_putWord(&dev->txBytes[4 * i], (first + i < count) ? txWords[first + i] : flushWord);
+		}
+		spidev_message(dev, frames);
+		for (i = 0; i < frames; i++) {
+			if (first + i >= RHS_PIPELINE_DEPTH) {
+				rxWords[first + i - RHS_PIPELINE_DEPTH] = spidev_getWord(&dev->rxBytes[4 * i]);
+			}
+		}
+	}
+}
+
+uint32_t rhs2116_spidevCommand(void *ctx, uint32_t txWord) {
+	uint32_t rxWord = 0;
+	rhs2116_spidevBatch(ctx, &txWord, &rxWord, 1);
+	return rxWord;
+}
+
+void rhs2116_spidevSimInit(Rhs2116_SpidevSim_t *sim, const Rhs2116_Transport_t *chip) {
+	memset(sim, 0, sizeof(*sim));
+	sim->chip = *chip;
+}
+
+int rhs2116_spidevSimIoctl(void *ctx, int fd, unsigned long request, void *arg) {
+	Rhs2116_SpidevSim_t *sim = ctx;
+	struct spi_ioc_transfer *transfers = arg;
+	size_t count;
+	size_t i;
+	int bytes = 0;
+	(void) fd;
+
+	if (request == SPI_IOC_WR_MODE || request == SPI_IOC_WR_BITS_PER_WORD
+			|| request == SPI_IOC_WR_MAX_SPEED_HZ) {
+		return 0;
+	}
+	if (_IOC_TYPE(request) != SPI_IOC_MAGIC || _IOC_NR(request) != 0
+			|| _IOC_DIR(request) != _IOC_WRITE) {
+		return -1;
+	}
+
+	count = _IOC_SIZE(request) / sizeof(struct spi_ioc_transfer);
+	sim->messages++;
+	for (i = 0; i < count; i++) {
+		const uint8_t *tx = (const uint8_t *) (uintptr_t) transfers[i].tx_buf;
+		uint8_t *rx = (uint8_t *) (uintptr_t) transfers[i].rx_buf;
+
+		if (transfers[i].len != 4) {
+			return -1;
+		}
+		if (i + 1 < count && !transfers[i].cs_change) {
+			sim->csViolations++;
+		}
+		spidev_putWord(rx, sim->pipeline[0]);
+		memmove(&sim->pipeline[0], &sim->pipeline[1],
+				(RHS_PIPELINE_DEPTH - 1) * sizeof(sim->pipeline[0]));
+		sim->pipeline[RHS_PIPELINE_DEPTH - 1] = sim->chip.command(sim->chip.ctx, spidev_getWord(tx));
+		sim->frames++;
+		bytes += 4;
+	}
+	return bytes;
+}
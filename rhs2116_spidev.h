@@ -0,0 +1,69 @@
+/***************************************************************************//**
+ * @file rhs2116_spidev.h
+ * @brief Linux spidev transport for the RHS2116 driver
+ ******************************************************************************/
+
+#ifndef RHS2116_SPIDEV_H
+#define RHS2116_SPIDEV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <linux/spi/spidev.h>
+#include "rhs2116.h"
+
+/*
+ * SPI_IOC_MESSAGE(n) encodes n * sizeof(struct spi_ioc_transfer) in the 14-bit
+ * ioctl size field, so one syscall carries at most 511 frames. Longer batches
+ * are split; the chip pipeline simply continues across syscalls.
+ */
+#define RHS_SPIDEV_MAX_FRAMES 511
+
+typedef int (*Rhs2116_SpidevIoctl_t)(void *ctx, int fd, unsigned long request, void *arg);
+
+/*
+ * spidev transport. Every 32-bit command is its own spi_ioc_transfer with
+ * cs_change set, so CS toggles between frames as the chip requires, and a whole
+ * batch goes out in one SPI_IOC_MESSAGE ioctl. spidev cannot set the CS-high
+ * time, and the SPI core may apply its default delay (10 us) between such
+ * transfers; account for it in Rhs2116_PlanRequest_t.frameGapNs.
+ */
+typedef struct
+{
+	int fd;
+	uint32_t speedHz;
+	Rhs2116_SpidevIoctl_t ioctl; // real ioctl() or a simulated stand-in
+	void *ioctlCtx;
+	bool ok;					  // cleared by the first failed ioctl
+	uint64_t syscalls;
+	uint64_t frames;
+	struct spi_ioc_transfer transfers[RHS_SPIDEV_MAX_FRAMES];
+	uint8_t txBytes[RHS_SPIDEV_MAX_FRAMES * 4];
+	uint8_t rxBytes[RHS_SPIDEV_MAX_FRAMES * 4];
+} Rhs2116_Spidev_t;
+
+bool rhs2116_spidevOpen(Rhs2116_Spidev_t *dev, const char *path, uint32_t speedHz);
+bool rhs2116_spidevAttach(Rhs2116_Spidev_t *dev, Rhs2116_SpidevIoctl_t ioctlFn, void *ioctlCtx,
+						  uint32_t speedHz);
+void rhs2116_spidevClose(Rhs2116_Spidev_t *dev);
+void rhs2116_spidevTransport(Rhs2116_Spidev_t *dev, Rhs2116_Transport_t *transport);
+uint32_t rhs2116_spidevCommand(void *ctx, uint32_t txWord);
+void rhs2116_spidevBatch(void *ctx, const uint32_t *txWords, uint32_t *rxWords, size_t count);
+
+/*
+ * Simulated spidev for running without hardware: accepts the mode/bits/speed
+ * setup ioctls and SPI_IOC_MESSAGE, answering each frame with the chip model's
+ * response to the frame sent two CS cycles earlier (e.g. a replay transport).
+ */
+typedef struct
+{
+	Rhs2116_Transport_t chip; // command() answers a command immediately
+	uint32_t pipeline[RHS_PIPELINE_DEPTH]; // answers still in flight inside the chip
+	uint64_t messages;
+	uint64_t frames;
+	uint64_t csViolations; // frames not delimited by a CS toggle
+} Rhs2116_SpidevSim_t;
+
+void rhs2116_spidevSimInit(Rhs2116_SpidevSim_t *sim, const Rhs2116_Transport_t *chip);
+int rhs2116_spidevSimIoctl(void *ctx, int fd, unsigned long request, void *arg);
+
+#endif // RHS2116_SPIDEV_H